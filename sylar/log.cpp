@@ -1,5 +1,14 @@
 #include "log.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstring>
 #include <ctime>
 #include <functional>
 namespace sylar {
@@ -208,10 +217,231 @@ bool FileLogAppender::reopen() {
   return !!m_filestream;
 }
 
+// 非阻塞fd写满时等待可写
+static void WaitWritable(int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  pfd.revents = 0;
+  poll(&pfd, 1, -1);
+}
+
+StdoutLogAppender::StdoutLogAppender(size_t buffer_size,
+                                     uint32_t flush_interval_ms,
+                                     bool zero_copy)
+    : m_flushInterval(flush_interval_ms) {
+  long page = sysconf(_SC_PAGESIZE);
+  if (page <= 0) {
+    page = 4096;
+  }
+  m_capacity = (buffer_size + page - 1) / page * page;
+  if (m_capacity == 0) {
+    m_capacity = page;
+  }
+
+  // 零拷贝时缓冲区取两倍管道容量, 写满刷新时一次至少送出一个管道容量,
+  // 另一块缓冲区就能复用, 见flushLocked
+  struct stat st;
+  if (zero_copy && fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode)) {
+    int pipe_size = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+    if (pipe_size > 0) {
+      m_zeroCopy = true;
+      m_pipeSize = pipe_size;
+      m_capacity = 2 * m_pipeSize;
+    }
+  }
+
+  // 延迟为0时不缓冲, 每条日志直接write
+  if (m_flushInterval.count() > 0 && allocBuffers()) {
+    m_thread = std::thread(&StdoutLogAppender::flushThread, this);
+  }
+}
+
+StdoutLogAppender::~StdoutLogAppender() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cond.notify_one();
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  flushLocked();
+  freeBuffers();
+}
+
 void StdoutLogAppender::log(std::shared_ptr<Logger> logger,
                             LogLevel::Level level, LogEvent::ptr event) {
   if (level >= m_level) {
-    std::cout << m_formatter->format(logger, level, event);
+    std::string str = m_formatter->format(logger, level, event);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (level >= m_errorLevel) {
+      // 先刷出已缓冲的stdout日志, 保证前后顺序
+      flushLocked();
+      writeAll(STDERR_FILENO, str.data(), str.size());
+    } else {
+      append(str);
+    }
+  }
+}
+
+void StdoutLogAppender::flush() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  flushLocked();
+}
+
+LogLevel::Level StdoutLogAppender::getErrorLevel() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_errorLevel;
+}
+
+void StdoutLogAppender::setErrorLevel(LogLevel::Level val) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_errorLevel = val;
+}
+
+void StdoutLogAppender::append(const std::string &str) {
+  if (m_size + str.size() > m_capacity) {
+    flushLocked();
+  }
+  if (!m_buffer || str.size() > m_capacity) {
+    m_written += writeAll(STDOUT_FILENO, str.data(), str.size());
+    return;
+  }
+  if (m_size == 0) {
+    m_firstTime = std::chrono::steady_clock::now();
+    m_cond.notify_one();
+  }
+  memcpy(m_buffer + m_size, str.data(), str.size());
+  m_size += str.size();
+}
+
+void StdoutLogAppender::flushLocked() {
+  if (m_size == 0) {
+    return;
+  }
+  int other = 1 - m_index;
+  size_t done = 0;
+  if (m_zeroCopy && isReleased(other, m_size)) {
+    if (!spliceAll(m_buffer, m_size, done)) {
+      // vmsplice不可用, 退回write
+      m_zeroCopy = false;
+    }
+  }
+  m_written += done;
+  if (done < m_size) {
+    m_written += writeAll(STDOUT_FILENO, m_buffer + done, m_size - done);
+  }
+  m_size = 0;
+  if (done > 0) {
+    m_inPipe[m_index] = true;
+    m_splicedEnd[m_index] = m_written;
+    // splice中途失败时(通常是读端已关闭)另一块可能还不能复用,
+    // 数据已经write出去, 继续用当前这块
+    if (isReleased(other, 0)) {
+      m_index = other;
+      m_buffer = m_buffers[m_index];
+    }
+  }
+}
+
+// vmsplice后管道仍引用缓冲区的页, 读端取走之前不能改写.
+// 管道容量为N字节时, 某块缓冲区splice之后又向stdout送出了N字节,
+// 它的页一定已被读走. 每次都重新查询管道容量, 防止被F_SETPIPE_SZ调大.
+bool StdoutLogAppender::isReleased(int index, size_t pending) {
+  if (!m_inPipe[index]) {
+    return true;
+  }
+  int pipe_size = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+  if (pipe_size <= 0) {
+    return false;
+  }
+  if ((size_t)pipe_size > m_pipeSize) {
+    m_pipeSize = pipe_size;
+  }
+  return m_written + pending - m_splicedEnd[index] >= m_pipeSize;
+}
+
+size_t StdoutLogAppender::writeAll(int fd, const char *data, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = ::write(fd, data + done, len - done);
+    if (n > 0) {
+      done += n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      WaitWritable(fd);
+    } else {
+      break;
+    }
+  }
+  return done;
+}
+
+bool StdoutLogAppender::spliceAll(const char *data, size_t len,
+                                  size_t &done) {
+  while (done < len) {
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(data + done);
+    iov.iov_len = len - done;
+    ssize_t n = vmsplice(STDOUT_FILENO, &iov, 1, 0);
+    if (n > 0) {
+      done += n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      WaitWritable(STDOUT_FILENO);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool StdoutLogAppender::allocBuffers() {
+  // 只有零拷贝时需要第二块缓冲区
+  int count = m_zeroCopy ? 2 : 1;
+  for (int i = 0; i < count; ++i) {
+    void *p = mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (p == MAP_FAILED) {
+      break;
+    }
+    m_buffers[i] = static_cast<char *>(p);
+  }
+  if (!m_buffers[1]) {
+    m_zeroCopy = false;
+  }
+  m_index = 0;
+  m_buffer = m_buffers[0];
+  return m_buffer != nullptr;
+}
+
+void StdoutLogAppender::freeBuffers() {
+  for (int i = 0; i < 2; ++i) {
+    if (m_buffers[i]) {
+      munmap(m_buffers[i], m_capacity);
+      m_buffers[i] = nullptr;
+    }
+  }
+  m_buffer = nullptr;
+}
+
+void StdoutLogAppender::flushThread() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_stop) {
+    if (m_size == 0) {
+      m_cond.wait(lock);
+      continue;
+    }
+    auto deadline = m_firstTime + m_flushInterval;
+    if (std::chrono::steady_clock::now() >= deadline) {
+      flushLocked();
+    } else {
+      m_cond.wait_until(lock, deadline);
+    }
   }
 }
 
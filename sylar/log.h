@@ -1,13 +1,17 @@
 #pragma once
 #include <stdarg.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "singleton.h"
@@ -170,11 +174,57 @@ class Logger : public std::enable_shared_from_this<Logger> {
 };
 
 // 输出到控制台的appender
+// 不经过iostream, 日志先写入加锁的行缓冲区, 缓冲区满或超过最大刷新延迟时
+// 批量write到stdout. 级别 >= errorLevel 的日志直接写stderr, 不缓冲.
+//
+// zero_copy为true且stdout是管道时改用vmsplice, 管道直接引用缓冲区的页.
+// 缓冲区只有在之后又向stdout送出一个管道容量的数据后才会复用, 因此要求读端:
+//   - 用read消费数据, 不能splice/tee把页转给别处继续引用
+//   - 不能在读走之前把管道调大又调小(调大没问题, 每次复用前都会重新查询)
+// 不满足时输出会被改写, 所以默认关闭.
 class StdoutLogAppender : public LogAppender {
  public:
   typedef std::shared_ptr<StdoutLogAppender> ptr;
+  // buffer_size: 缓冲区大小(按页对齐, 零拷贝时取两倍管道容量),
+  // flush_interval_ms: 最大刷新延迟, 为0时每条日志立即写出,
+  // zero_copy: stdout是管道时是否使用vmsplice
+  StdoutLogAppender(size_t buffer_size = 64 * 1024,
+                    uint32_t flush_interval_ms = 100, bool zero_copy = false);
+  ~StdoutLogAppender();
   virtual void log(std::shared_ptr<Logger> logger, LogLevel ::Level level,
                    LogEvent::ptr event) override;
+  void flush();
+  LogLevel::Level getErrorLevel() const;
+  void setErrorLevel(LogLevel::Level val);
+
+ private:
+  void append(const std::string &str);
+  void flushLocked();
+  bool isReleased(int index, size_t pending);
+  size_t writeAll(int fd, const char *data, size_t len);
+  bool spliceAll(const char *data, size_t len, size_t &done);
+  bool allocBuffers();
+  void freeBuffers();
+  void flushThread();
+
+ private:
+  char *m_buffers[2] = {nullptr, nullptr};  // 双缓冲(mmap分配), 零拷贝时轮换
+  bool m_inPipe[2] = {false, false};        // 是否splice过, 页可能还在管道里
+  uint64_t m_splicedEnd[2] = {0, 0};  // 最后一次splice后的m_written
+  uint64_t m_written = 0;             // 累计送到stdout的字节数
+  size_t m_pipeSize = 0;              // 见过的最大管道容量
+  int m_index = 0;                    // 当前写入的缓冲区
+  char *m_buffer = nullptr;           // 当前行缓冲区
+  size_t m_capacity = 0;              // 缓冲区容量
+  size_t m_size = 0;                  // 已缓冲字节数
+  std::chrono::milliseconds m_flushInterval;  // 最大刷新延迟
+  std::chrono::steady_clock::time_point m_firstTime;  // 最早未刷新日志的时间
+  LogLevel::Level m_errorLevel = LogLevel::ERROR;     // 走stderr的最低级别
+  bool m_zeroCopy = false;  // stdout是管道时使用vmsplice
+  bool m_stop = false;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cond;
+  std::thread m_thread;  // 按最大延迟刷新缓冲区
 };
 
 // 输出到文件的appender
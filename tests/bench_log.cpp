@@ -0,0 +1,71 @@
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+#include "../sylar/log.h"
+#include "../sylar/util.h"
+
+// 原先经过std::cout的控制台appender, 作为对照
+class CoutLogAppender : public sylar::LogAppender {
+ public:
+  void log(std::shared_ptr<sylar::Logger> logger, sylar::LogLevel::Level level,
+           sylar::LogEvent::ptr event) override {
+    if (level >= m_level) {
+      std::cout << m_formatter->format(logger, level, event);
+    }
+  }
+};
+
+static uint64_t NowUs() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_sec * 1000000ul + tv.tv_usec;
+}
+
+static std::string s_payload;
+
+static uint64_t Run(sylar::LogAppender::ptr appender, int count) {
+  sylar::Logger::ptr logger(new sylar::Logger("bench"));
+  logger->addAppender(appender);
+  uint64_t begin = NowUs();
+  for (int i = 0; i < count; ++i) {
+    SYLAR_LOG_INFO(logger) << s_payload;
+  }
+  logger->delAppender(appender);
+  appender.reset();  // 析构时刷出剩余缓冲
+  return NowUs() - begin;
+}
+
+// 用法: bench_log [count] [rounds] [msg_size] | cat > /dev/null
+// 结果输出到stderr, stdout是被测目标; 各appender交替运行, 取最好成绩.
+// 使用Logger默认格式, 整行长度不能整除缓冲区大小
+int main(int argc, char const *argv[]) {
+  int count = argc > 1 ? atoi(argv[1]) : 200000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 5;
+  int msg_size = argc > 3 ? atoi(argv[3]) : 200;
+  s_payload.assign(msg_size, 'x');
+
+  uint64_t cout_us = UINT64_MAX;
+  uint64_t write_us = UINT64_MAX;
+  uint64_t splice_us = UINT64_MAX;
+  for (int i = 0; i < rounds; ++i) {
+    cout_us = std::min(
+        cout_us, Run(sylar::LogAppender::ptr(new CoutLogAppender), count));
+    write_us = std::min(
+        write_us, Run(sylar::LogAppender::ptr(new sylar::StdoutLogAppender(
+                          64 * 1024, 100, false)),
+                      count));
+    splice_us = std::min(
+        splice_us, Run(sylar::LogAppender::ptr(new sylar::StdoutLogAppender(
+                           64 * 1024, 100, true)),
+                       count));
+  }
+  std::cerr << "count=" << count << " rounds=" << rounds
+            << " msg_size=" << msg_size << std::endl
+            << "std::cout: " << cout_us << " us" << std::endl
+            << "write:     " << write_us << " us" << std::endl
+            << "vmsplice:  " << splice_us << " us" << std::endl;
+  return 0;
+}
@@ -0,0 +1,279 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include "../sylar/log.h"
+#include "../sylar/util.h"
+
+static int s_failed = 0;
+
+#define CHECK(cond)                                                     \
+  if (!(cond)) {                                                        \
+    ++s_failed;                                                         \
+    std::cerr << __FILE__ << ":" << __LINE__ << " CHECK failed: " #cond \
+              << std::endl;                                             \
+  }
+
+static size_t s_splicedBytes = 0;
+
+// 覆盖libc的vmsplice(可执行文件以-rdynamic导出), 统计splice的字节数
+extern "C" ssize_t vmsplice(int fd, const struct iovec *iov, size_t nr_segs,
+                            unsigned int flags) {
+  ssize_t n = syscall(SYS_vmsplice, fd, iov, nr_segs, flags);
+  if (n > 0) {
+    s_splicedBytes += n;
+  }
+  return n;
+}
+
+// 从管道读, 直到读够want字节或timeout_ms内没有新数据
+static std::string ReadPipe(int fd, size_t want, int timeout_ms) {
+  std::string str;
+  char buf[4096];
+  while (str.size() < want) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+      break;
+    }
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    str.append(buf, n);
+  }
+  return str;
+}
+
+// 把stdout/stderr临时重定向到管道, merge为true时相当于2>&1
+class Redirect {
+ public:
+  Redirect(bool merge) {
+    std::cout.flush();
+    fflush(stdout);
+    m_saved[0] = dup(STDOUT_FILENO);
+    m_saved[1] = dup(STDERR_FILENO);
+    OpenPipe(m_out);
+    dup2(m_out[1], STDOUT_FILENO);
+    if (merge) {
+      dup2(m_out[1], STDERR_FILENO);
+    } else {
+      OpenPipe(m_err);
+      dup2(m_err[1], STDERR_FILENO);
+    }
+  }
+  ~Redirect() {
+    dup2(m_saved[0], STDOUT_FILENO);
+    dup2(m_saved[1], STDERR_FILENO);
+    for (int fd : {m_saved[0], m_saved[1], m_out[0], m_out[1], m_err[0],
+                   m_err[1]}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+  std::string readOut(size_t want, int timeout_ms) {
+    return ReadPipe(m_out[0], want, timeout_ms);
+  }
+  std::string readErr(size_t want, int timeout_ms) {
+    return ReadPipe(m_err[0], want, timeout_ms);
+  }
+  bool resizeOut(int size) {
+    return fcntl(m_out[1], F_SETPIPE_SZ, size) >= size;
+  }
+
+ private:
+  static void OpenPipe(int fds[2]) {
+    if (pipe(fds) == 0) {
+      fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    }
+  }
+
+ private:
+  int m_saved[2] = {-1, -1};
+  int m_out[2] = {-1, -1};
+  int m_err[2] = {-1, -1};
+};
+
+static sylar::LogFormatter::ptr s_formatter;
+
+// Logger和LogFormatter构造时会往std::cout打印, 要在重定向之前创建
+static sylar::Logger::ptr NewLogger() {
+  sylar::Logger::ptr logger(new sylar::Logger("test"));
+  return logger;
+}
+
+// 长度为len(不含换行)的第i行, 内容各不相同
+static std::string MakeLine(int i, size_t len) {
+  std::string line = "line " + std::to_string(i) + " ";
+  line.resize(len, 'x');
+  return line;
+}
+
+static sylar::StdoutLogAppender::ptr NewAppender(sylar::Logger::ptr logger,
+                                                 size_t buffer_size,
+                                                 uint32_t flush_interval_ms,
+                                                 bool zero_copy = false) {
+  sylar::StdoutLogAppender::ptr appender(new sylar::StdoutLogAppender(
+      buffer_size, flush_interval_ms, zero_copy));
+  appender->setFormatter(s_formatter);
+  logger->addAppender(appender);
+  return appender;
+}
+
+// INFO走stdout, ERROR/FATAL走stderr
+static void TestRouting() {
+  sylar::Logger::ptr logger = NewLogger();
+  std::string out, err;
+  {
+    Redirect r(false);
+    auto appender = NewAppender(logger, 64 * 1024, 10000);
+    SYLAR_LOG_INFO(logger) << "info";
+    SYLAR_LOG_ERROR(logger) << "error";
+    SYLAR_LOG_FATAL(logger) << "fatal";
+    appender->flush();
+    out = r.readOut(SIZE_MAX, 0);
+    err = r.readErr(SIZE_MAX, 0);
+    logger->delAppender(appender);
+  }
+  CHECK(out == "info\n");
+  CHECK(err == "error\nfatal\n");
+}
+
+// 2>&1时, 缓冲中的INFO先于之后的ERROR输出
+static void TestOrder() {
+  sylar::Logger::ptr logger = NewLogger();
+  std::string out;
+  {
+    Redirect r(true);
+    auto appender = NewAppender(logger, 64 * 1024, 10000);
+    SYLAR_LOG_INFO(logger) << "a";
+    SYLAR_LOG_INFO(logger) << "b";
+    SYLAR_LOG_ERROR(logger) << "c";
+    out = r.readOut(SIZE_MAX, 0);
+    logger->delAppender(appender);
+  }
+  CHECK(out == "a\nb\nc\n");
+}
+
+// 不调用flush也不析构, 缓冲的日志在flush_interval_ms之后送达
+static void TestFlushInterval() {
+  sylar::Logger::ptr logger = NewLogger();
+  std::string before, after;
+  {
+    Redirect r(false);
+    auto appender = NewAppender(logger, 64 * 1024, 100);
+    SYLAR_LOG_INFO(logger) << "late";
+    before = r.readOut(SIZE_MAX, 0);
+    after = r.readOut(5, 5000);
+    logger->delAppender(appender);
+  }
+  CHECK(before.empty());
+  CHECK(after == "late\n");
+}
+
+// flush_interval_ms为0, 以及超过buffer_size的日志, 都直接写出
+static void TestWriteThrough() {
+  sylar::Logger::ptr logger = NewLogger();
+  std::string line(10000, 'x');
+  std::string direct, large;
+  {
+    Redirect r(false);
+    auto appender = NewAppender(logger, 64 * 1024, 0);
+    SYLAR_LOG_INFO(logger) << "direct";
+    direct = r.readOut(SIZE_MAX, 0);
+    logger->delAppender(appender);
+  }
+  {
+    Redirect r(false);
+    auto appender = NewAppender(logger, 4096, 10000, false);
+    SYLAR_LOG_INFO(logger) << line;
+    large = r.readOut(SIZE_MAX, 0);
+    logger->delAppender(appender);
+  }
+  CHECK(direct == "direct\n");
+  CHECK(large == line + "\n");
+}
+
+// 读端不读时, 管道里还没读走的内容不能被改写
+static void TestZeroCopyLagging() {
+  sylar::Logger::ptr logger = NewLogger();
+  std::string flushed;
+  {
+    // 每条都flush, 两块缓冲区都还在管道里
+    Redirect r(false);
+    auto appender = NewAppender(logger, 64 * 1024, 10000, true);
+    for (int i = 0; i < 4; ++i) {
+      SYLAR_LOG_INFO(logger) << "flush " << i;
+      appender->flush();
+    }
+    flushed = r.readOut(SIZE_MAX, 0);
+    logger->delAppender(appender);
+  }
+  CHECK(flushed == "flush 0\nflush 1\nflush 2\nflush 3\n");
+
+  // appender创建之后管道被调大, 能容纳多个缓冲区的数据
+  const int count = 600;
+  std::string expect, out;
+  bool resized = false;
+  {
+    Redirect r(false);
+    auto appender = NewAppender(logger, 64 * 1024, 10000, true);
+    resized = r.resizeOut(1024 * 1024);
+    for (int i = 0; i < count; ++i) {
+      expect += MakeLine(i, 999) + "\n";
+      SYLAR_LOG_INFO(logger) << MakeLine(i, 999);
+    }
+    appender->flush();
+    out = r.readOut(SIZE_MAX, 0);
+    logger->delAppender(appender);
+  }
+  CHECK(resized);
+  CHECK(out == expect);
+}
+
+// 读端正常读取时, 写满的缓冲区要真正轮换splice出去, 且内容正确
+static void TestZeroCopyRotation() {
+  const int count = 40000;
+  sylar::Logger::ptr logger = NewLogger();
+  std::string expect;
+  for (int i = 0; i < count; ++i) {
+    expect += MakeLine(i, 136) + "\n";
+  }
+  std::string out;
+  s_splicedBytes = 0;
+  {
+    Redirect r(false);
+    std::thread reader([&]() { out = r.readOut(expect.size(), 5000); });
+    auto appender = NewAppender(logger, 64 * 1024, 100, true);
+    for (int i = 0; i < count; ++i) {
+      SYLAR_LOG_INFO(logger) << MakeLine(i, 136);
+    }
+    appender->flush();
+    reader.join();
+    logger->delAppender(appender);
+  }
+  CHECK(out == expect);
+  CHECK(s_splicedBytes >= expect.size() / 2);
+}
+
+int main(int argc, char const *argv[]) {
+  s_formatter.reset(new sylar::LogFormatter("%m%n"));
+  TestRouting();
+  TestOrder();
+  TestFlushInterval();
+  TestWriteThrough();
+  TestZeroCopyLagging();
+  TestZeroCopyRotation();
+  std::cerr << (s_failed ? "FAILED" : "PASSED") << std::endl;
+  return s_failed ? 1 : 0;
+}